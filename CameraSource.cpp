@@ -16,6 +16,9 @@
 CameraSource::CameraSource(int cameraNumber)
 {
 	camera = cv::VideoCapture(cameraNumber);
+	mjpg = negotiateMode(camera);
+	frameSize = cv::Size((int)camera.get(CV_CAP_PROP_FRAME_WIDTH), (int)camera.get(CV_CAP_PROP_FRAME_HEIGHT));
+	canCrop = supportsCrop(camera);
 	noData = cv::imread("Test.bmp");
 	int w = std::max((int)camera.get(CV_CAP_PROP_FRAME_WIDTH), MEDIA_DEFAULT_WIDTH);
 	int h = std::max((int)camera.get(CV_CAP_PROP_FRAME_HEIGHT), MEDIA_DEFAULT_HEIGHT);
@@ -24,14 +27,53 @@ CameraSource::CameraSource(int cameraNumber)
 
 cv::Mat CameraSource::getImage()
 {
+	// When the camera delivers MJPG and the image is to be shrunk by at least half, fetch the
+	// compressed frame and let the JPEG decoder scale it down in the DCT domain.
+	int reduction = mjpg ? reductionDenominator() : 1;
+	setRaw(reduction > 1);
+
 	// Attempt to read an image from the camera. If this fails, the camera may not be available.
-	camera >> image;
-	if (!camera.isOpened() || !camera.grab() || image.empty())
+	// The frame keeps its own buffer, so the camera can reuse it while the image gets cropped.
+	camera >> frame;
+	if (!camera.isOpened() || !camera.grab() || frame.empty())
+	{
 		image = noData;
-	postProcess(image);
+		reduction = 1;
+	}
+	else if (raw && frame.rows == 1)
+	{
+		int flags = reduction == 2 ? cv::IMREAD_REDUCED_COLOR_2 :
+			reduction == 4 ? cv::IMREAD_REDUCED_COLOR_4 : cv::IMREAD_REDUCED_COLOR_8;
+		image = cv::imdecode(frame, flags);
+		if (image.empty())
+		{
+			image = noData;
+			reduction = 1;
+		}
+	}
+	else
+	{
+		// The backend ignored our request for raw data and decoded the frame itself.
+		image = frame;
+		reduction = 1;
+	}
+	postProcess(image, reduction);
 	return image;
 }
 
+void CameraSource::setRaw(bool enable)
+{
+	if (raw == enable)
+		return;
+	camera.set(CV_CAP_PROP_CONVERT_RGB, enable ? 0 : 1);
+	raw = enable;
+}
+
+bool CameraSource::cropDevice(const cv::Rect& area)
+{
+	return canCrop && ::cropDevice(camera, area, frameSize);
+}
+
 // ---------------------------------------------------------------------------------------------- *
 // Concrete subclass MovieSource to support movie files                                           *
 // ---------------------------------------------------------------------------------------------- *
@@ -59,20 +101,22 @@ inline MovieSource::MovieSource(std::string filename)
 inline cv::Mat MovieSource::getImage()
 {
 	// Attempt to read an image from the movie file. If this fails, the movie is possibly at its end.
-	// Reset the movie position and try again.
-	movie >> image;
-	if (!movie.isOpened() || !movie.grab() || image.empty())
+	// Reset the movie position and try again. The frame keeps its own buffer, so the movie can
+	// reuse it while the image gets cropped.
+	movie >> frame;
+	if (!movie.isOpened() || !movie.grab() || frame.empty())
 	{
 		movie.set(CV_CAP_PROP_POS_FRAMES, 0);
 		movie.set(CV_CAP_PROP_POS_MSEC, 0);
-		movie >> image;
+		movie >> frame;
 	}
 
 	// If the problem persists, return the no-data image.
-	if (!movie.isOpened() || !movie.grab() || image.empty())
+	if (!movie.isOpened() || !movie.grab() || frame.empty())
 		return noData;
 
 	// If we reach here, postprocess the image as normal.
+	image = frame;
 	postProcess(image);
 	return image;
 }
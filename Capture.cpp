@@ -0,0 +1,106 @@
+/*
+* Joost van Stuijvenberg
+* Avans Hogeschool Breda
+*
+* CC BY-SA 4.0, see: https://creativecommons.org/licenses/by-sa/4.0/
+* sources & updates: https://github.com/joostvanstuijvenberg/DemoCV
+*/
+
+#include "Capture.hpp"
+#include "opencv2/opencv.hpp"
+
+// ---------------------------------------------------------------------------------------------- *
+// Camera settings shared by Grab and CameraSource                                                *
+// ---------------------------------------------------------------------------------------------- *
+
+// Fixed preference list of capture modes, from most to least preferred. OpenCV cannot enumerate
+// the modes a camera supports, so each one is tried in turn. Modes larger than CAMERA_MAX_WIDTH
+// by CAMERA_MAX_HEIGHT are skipped: they make for huge windows, recordings and stack buffers.
+static const cv::Size cameraModes[] = {
+	cv::Size(3840, 2160),
+	cv::Size(2592, 1944),
+	cv::Size(1920, 1080),
+	cv::Size(1600, 1200),
+	cv::Size(1280, 720),
+	cv::Size(1024, 768),
+	cv::Size(800, 600),
+	cv::Size(640, 480)
+};
+
+// Selects the first mode from the preference list that the camera delivers in MJPG at a
+// reasonable frame rate. Returns false, with the original settings restored, if there is none.
+// Some backends (e.g. V4L2) reopen the device on every change, so as few settings as possible
+// are made: the format once, the frame rate only for a mode that was accepted.
+bool negotiateMode(cv::VideoCapture& capture)
+{
+	if (!capture.isOpened())
+		return false;
+
+	double originalFourcc = capture.get(CV_CAP_PROP_FOURCC);
+	double originalWidth = capture.get(CV_CAP_PROP_FRAME_WIDTH);
+	double originalHeight = capture.get(CV_CAP_PROP_FRAME_HEIGHT);
+	double originalFps = capture.get(CV_CAP_PROP_FPS);
+
+	// Read the settings back: drivers silently substitute what they do not support. Some
+	// drivers do not report a frame rate at all, so zero is taken as acceptable.
+	int fourcc = CV_FOURCC('M', 'J', 'P', 'G');
+	capture.set(CV_CAP_PROP_FOURCC, fourcc);
+	if ((int)capture.get(CV_CAP_PROP_FOURCC) == fourcc)
+	{
+		for (const cv::Size& mode : cameraModes)
+		{
+			if (mode.width > CAMERA_MAX_WIDTH || mode.height > CAMERA_MAX_HEIGHT)
+				continue;
+			capture.set(CV_CAP_PROP_FRAME_WIDTH, mode.width);
+			capture.set(CV_CAP_PROP_FRAME_HEIGHT, mode.height);
+			if ((int)capture.get(CV_CAP_PROP_FOURCC) != fourcc ||
+				(int)capture.get(CV_CAP_PROP_FRAME_WIDTH) != mode.width ||
+				(int)capture.get(CV_CAP_PROP_FRAME_HEIGHT) != mode.height)
+				continue;
+			capture.set(CV_CAP_PROP_FPS, CAMERA_DEFAULT_FPS);
+			double fps = capture.get(CV_CAP_PROP_FPS);
+			if (fps == 0 || fps >= CAMERA_MIN_FPS)
+				return true;
+		}
+	}
+
+	// No MJPG mode found: go back to what the camera opened with.
+	capture.set(CV_CAP_PROP_FOURCC, originalFourcc);
+	capture.set(CV_CAP_PROP_FRAME_WIDTH, originalWidth);
+	capture.set(CV_CAP_PROP_FRAME_HEIGHT, originalHeight);
+	if (originalFps > 0)
+		capture.set(CV_CAP_PROP_FPS, originalFps);
+	return false;
+}
+
+// OpenCV only exposes sensor cropping for a few backends (e.g. XIMEA). Other backends do not
+// support these properties and may complain about each attempt, so check once when the camera
+// opens and only call cropDevice() if this returns true.
+bool supportsCrop(cv::VideoCapture& capture)
+{
+	return capture.isOpened() && capture.get(CV_CAP_PROP_XI_WIDTH) > 0;
+}
+
+// Asks the camera to crop to the region, or to deliver the full frame of the given size when
+// the region is empty. The settings are read back to see whether the camera went along.
+// Returns true only if the camera now crops to a non-empty region. If it cannot, the full frame
+// is restored.
+bool cropDevice(cv::VideoCapture& capture, const cv::Rect& region, cv::Size size)
+{
+	cv::Rect r = region.area() > 0 ? region : cv::Rect(cv::Point(0, 0), size);
+	capture.set(CV_CAP_PROP_XI_OFFSET_X, 0);
+	capture.set(CV_CAP_PROP_XI_OFFSET_Y, 0);
+	capture.set(CV_CAP_PROP_XI_WIDTH, r.width);
+	capture.set(CV_CAP_PROP_XI_HEIGHT, r.height);
+	capture.set(CV_CAP_PROP_XI_OFFSET_X, r.x);
+	capture.set(CV_CAP_PROP_XI_OFFSET_Y, r.y);
+	if ((int)capture.get(CV_CAP_PROP_XI_OFFSET_X) == r.x &&
+		(int)capture.get(CV_CAP_PROP_XI_OFFSET_Y) == r.y &&
+		(int)capture.get(CV_CAP_PROP_XI_WIDTH) == r.width &&
+		(int)capture.get(CV_CAP_PROP_XI_HEIGHT) == r.height)
+		return region.area() > 0;
+
+	if (region.area() > 0)
+		cropDevice(capture, cv::Rect(), size);
+	return false;
+}
@@ -0,0 +1,27 @@
+/*
+* Joost van Stuijvenberg
+* Avans Hogeschool Breda
+*
+* CC BY-SA 4.0, see: https://creativecommons.org/licenses/by-sa/4.0/
+* sources & updates: https://github.com/joostvanstuijvenberg/DemoCV
+*/
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "opencv2/opencv.hpp"
+
+#define CAMERA_DEFAULT_FPS		30
+#define CAMERA_MIN_FPS			15
+#define CAMERA_MAX_WIDTH		1280
+#define CAMERA_MAX_HEIGHT		768
+
+// ---------------------------------------------------------------------------------------------- *
+// Camera settings shared by Grab and CameraSource                                                *
+// ---------------------------------------------------------------------------------------------- *
+
+bool negotiateMode(cv::VideoCapture& capture);
+bool supportsCrop(cv::VideoCapture& capture);
+bool cropDevice(cv::VideoCapture& capture, const cv::Rect& region, cv::Size size);
+
+#endif
@@ -41,14 +41,29 @@
 
 #include <iostream>
 #include <iomanip>
+#include <sstream>
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include "Capture.hpp"
+#include "Stacker.hpp"
+
 #define GRAB_VERSION			"1.1.0"
 #define DEFAULT_CAMERA			"0"
 
+// Mouse state for the Source window: the image shown and the rectangle being dragged, in view
+// coordinates.
+struct Selection
+{
+	cv::Mat* image;
+	cv::Point start;
+	cv::Rect rect;
+	bool dragging = false;
+	bool done = false;
+};
+
 std::string dateTimeFileName(std::string extension);
 void onMouseClick(int event, int x, int y, int flags, void* userdata);
 
@@ -65,9 +80,30 @@ int main(int argc, char** argv)
 	std::cout << "Avans Hogeschool Breda" << std::endl;
 	std::cout << "-------------------------------------------------------------------------------" << std::endl;
 
+	// Parameters are positional: Grab [camera [frames to stack [x,y,width,height]]]. To pass a
+	// region of interest, the camera number and the number of frames must be given as well.
+
 	// First optional parameter: camera number (expecting a valid integer).
 	std::string camera = argc > 1 ? argv[1] : DEFAULT_CAMERA;
 
+	// Second optional parameter: number of frames to stack (expecting a valid integer).
+	int depth = argc > 2 ? std::stoi(argv[2]) : STACK_DEPTH_DEFAULT;
+	Stacker stacker(depth);
+
+	// Third optional parameter: region of interest as x,y,width,height (expecting integers).
+	cv::Rect region;
+	if (argc > 3)
+	{
+		std::istringstream iss(argv[3]);
+		char comma;
+		iss >> region.x >> comma >> region.y >> comma >> region.width >> comma >> region.height;
+		if (iss.fail() || region.width <= 0 || region.height <= 0)
+		{
+			std::cerr << "Ignoring region of interest " << argv[3] << ", expecting x,y,width,height with a positive width and height." << std::endl;
+			region = cv::Rect();
+		}
+	}
+
 	// See if we can access the camera using the given camera number. A path to a movie file is
 	// currently not supported.
 	cv::VideoCapture capture(std::stoi(camera));
@@ -78,44 +114,113 @@ int main(int argc, char** argv)
 		return -1;
 	}
 
+	// Ask for MJPG at a decent resolution and frame rate; many USB cameras otherwise fall back to
+	// raw YUYV at a low frame rate.
+	int64 ticks = cv::getTickCount();
+	bool mjpg = negotiateMode(capture);
+	int negotiationMs = (int)((cv::getTickCount() - ticks) * 1000 / cv::getTickFrequency());
+	cv::Size size = cv::Size((int)capture.get(CV_CAP_PROP_FRAME_WIDTH), (int)capture.get(CV_CAP_PROP_FRAME_HEIGHT));
+
+	// Clip the region of interest to the frame and have the camera crop it, if it can. Whether it
+	// can is only asked once: most backends complain about every crop property we touch.
+	bool canCrop = supportsCrop(capture);
+	if (region.area() > 0)
+	{
+		cv::Rect requested = region;
+		region &= cv::Rect(cv::Point(0, 0), size);
+		if (region.area() == 0)
+			std::cerr << "Ignoring region of interest " << requested << ", it lies outside the " << size << " frame." << std::endl;
+	}
+	bool deviceCropped = canCrop && region.area() > 0 && cropDevice(capture, region, size);
+
+	std::cout << "Usage: Grab [camera [frames to stack [x,y,width,height]]]" << std::endl;
 	std::cout << "Clicking in the camera window will display the selected pixel properties. Press" << std::endl;
 	std::cout << "<SPACE> to save a snapshot, <RETURN> to start or stop recording, <ESC> to exit," << std::endl;
-	std::cout << "<h> to flip horizontally and <v> to flip vertically. Make sure to press keys" << std::endl;
-	std::cout << "while the image window has focus." << std::endl;
+	std::cout << "<h> to flip horizontally and <v> to flip vertically. <t> cycles through frame" << std::endl;
+	std::cout << "stacking (average, median, max); while stacking, recordings become a timelapse." << std::endl;
+	std::cout << "Drag a rectangle in the camera window to select a region of interest, <r> to" << std::endl;
+	std::cout << "return to the full frame." << std::endl;
+	std::cout << "Make sure to press keys while the image window has focus." << std::endl;
 	std::cout << "-------------------------------------------------------------------------------" << std::endl;
 	std::cout << "Using camera . . . . : " + camera << std::endl;
+	std::cout << "Capture mode . . . . : " << (int)capture.get(CV_CAP_PROP_FRAME_WIDTH) << 'x' << (int)capture.get(CV_CAP_PROP_FRAME_HEIGHT) << (mjpg ? " MJPG" : " (camera default)") << ", negotiated in " << negotiationMs << " ms" << std::endl;
+	std::cout << "Frames to stack  . . : " << stacker.getDepth() << std::endl;
+	if (region.area() > 0)
+		std::cout << "Region of interest . : " << region << (deviceCropped ? " (cropped by the camera)" : "") << std::endl;
+	else
+		std::cout << "Region of interest . : full frame" << std::endl;
 	std::cout << "-------------------------------------------------------------------------------" << std::endl;
 
-	cv::Mat image, copy;
+	cv::Mat frame, image, copy;
 	cv::namedWindow("Source", CV_WINDOW_AUTOSIZE);
-	cv::Size size = cv::Size((int)capture.get(CV_CAP_PROP_FRAME_WIDTH), (int)capture.get(CV_CAP_PROP_FRAME_HEIGHT));
 	//int x = (GetSystemMetrics(SM_CXSCREEN) / 2) - (size.width / 2);
 	//int y = (GetSystemMetrics(SM_CYSCREEN) / 2) - (size.height / 2);
 	//cv::moveWindow("Source", x, y);
-	cv::setMouseCallback("Source", onMouseClick, &image);
+	Selection selection;
+	selection.image = &image;
+	cv::setMouseCallback("Source", onMouseClick, &selection);
 	cv::VideoWriter writer;
 	std::string fileName;
 	bool recording = false, flipH = false, flipV = false;
 	char key = 0;
 	while (key != 27)
 	{
-		// Capture an image and flip it horizontally and/or vertically, as requested. If we are
-		// recording, write the captured (and possibly flipped) image to the video file.
-		capture >> image;
+		// Capture a frame and, if the camera could not crop it itself, take a view on the region
+		// of interest so that everything downstream only deals with the pixels we need. The
+		// frame keeps its own buffer, so the capture can reuse it every time. Flip it
+		// horizontally and/or vertically, as requested. Stack it with the previous frames if
+		// requested. If we are recording, write the captured (and possibly flipped) image to the
+		// video file. While stacking, only every K-th stacked image is written, which makes the
+		// recording a timelapse.
+		capture >> frame;
+		image = frame;
+		if (!frame.empty() && region.area() > 0 && !deviceCropped)
+			image = frame(region & cv::Rect(0, 0, frame.cols, frame.rows));
 		if (flipH)
 			cv::flip(image, image, 1);
 		if (flipV)
 			cv::flip(image, image, 0);
-		if (recording)
+		image = stacker.stack(image);
+		if (stacker.isRefused())
+		{
+			std::cout << "The image is too large for median stacking of " << stacker.getDepth() << " frames. Select a" << std::endl;
+			std::cout << "smaller region of interest or stack fewer frames. No longer stacking." << std::endl;
+			stacker.reset();
+		}
+		if (recording && (stacker.getMode() == StackMode::None || stacker.isComplete()))
 			writer << image;
 
-		// Show the image. Display a red dot in the upper left corner if we are recording.
-		// Note that this doesn't affect the original image (we show a copy).
+		// Show the image. Display a red dot in the upper left corner if we are recording and
+		// the rectangle being dragged, if any. Note that this doesn't affect the original image
+		// (we show a copy).
 		copy = image.clone();
 		if (recording)
 			cv::circle(copy, cv::Point(20, 20), 10, cv::Scalar(0, 0, 255), -1);
+		if (selection.dragging)
+			cv::rectangle(copy, selection.rect, cv::Scalar(0, 255, 255));
 		cv::imshow("Source", copy);
 		key = cv::waitKey(40);
+
+		// A rectangle was dragged: translate it from view coordinates (possibly flipped and
+		// already cropped) to frame coordinates and use it as the new region of interest.
+		if (selection.done)
+		{
+			selection.done = false;
+			if (recording)
+				std::cout << "Stop recording before selecting a region of interest." << std::endl;
+			else
+			{
+				cv::Rect rect = selection.rect & cv::Rect(0, 0, image.cols, image.rows);
+				if (flipH)
+					rect.x = image.cols - rect.x - rect.width;
+				if (flipV)
+					rect.y = image.rows - rect.y - rect.height;
+				region = rect + region.tl();
+				deviceCropped = canCrop && cropDevice(capture, region, size);
+				stacker.reset();
+				std::cout << "Region of interest is " << region << (deviceCropped ? " (cropped by the camera)." : ".") << std::endl;
+			}
+		}
 		
 		// Handle the keys.
 		switch (key) {
@@ -123,6 +228,7 @@ int main(int argc, char** argv)
 		// h-key: flip the image horizontally.
 		case 'h':
 			flipH = !flipH;
+			stacker.reset();
 			if (flipH)
 				std::cout << "Flipping horizontally." << std::endl;
 			else
@@ -132,12 +238,46 @@ int main(int argc, char** argv)
 		// v-key: flip the image vertically.
 		case 'v':
 			flipV = !flipV;
+			stacker.reset();
 			if (flipV)
 				std::cout << "Flipping vertically." << std::endl;
 			else
 				std::cout << "No longer flipping vertically." << std::endl;
 			break;
 
+		// t-key: cycle through the stacking modes.
+		case 't':
+			stacker.nextMode();
+			switch (stacker.getMode())
+			{
+			case StackMode::Average:
+				std::cout << "Stacking by average of " << stacker.getDepth() << " frames." << std::endl;
+				break;
+			case StackMode::Median:
+				std::cout << "Stacking by median of " << stacker.getDepth() << " frames." << std::endl;
+				break;
+			case StackMode::Max:
+				std::cout << "Stacking by maximum of " << stacker.getDepth() << " frames." << std::endl;
+				break;
+			default:
+				std::cout << "No longer stacking." << std::endl;
+				break;
+			}
+			break;
+
+		// r-key: return to the full frame.
+		case 'r':
+			if (recording)
+				std::cout << "Stop recording before changing the region of interest." << std::endl;
+			else
+			{
+				region = cv::Rect();
+				deviceCropped = canCrop && cropDevice(capture, region, size);
+				stacker.reset();
+				std::cout << "Using the full frame." << std::endl;
+			}
+			break;
+
 		// Space bar: make a snapshot and store it in the specified output path.
 		case 32:
 			fileName = dateTimeFileName("bmp");
@@ -151,7 +291,7 @@ int main(int argc, char** argv)
 			{
 				recording = true;
 				fileName = dateTimeFileName("avi");
-				writer.open(fileName, 0, 25, size);
+				writer.open(fileName, 0, 25, image.size());
 				if (!writer.isOpened())
 				{
 					std::cerr << "Could not open the video file for writing. Press Enter to quit." << std::endl;
@@ -198,9 +338,25 @@ void onMouseClick(int event, int x, int y, int flags, void* userdata)
 {
 	std::ostringstream oss;
 
+	Selection* selection = (Selection *)userdata;
+
+	// Dragging selects a region of interest; the main loop picks it up once the button is released.
+	if (event == CV_EVENT_MOUSEMOVE && selection->dragging)
+		selection->rect = cv::Rect(selection->start, cv::Point(x, y));
+	if (event == CV_EVENT_LBUTTONUP && selection->dragging)
+	{
+		selection->dragging = false;
+		selection->rect = cv::Rect(selection->start, cv::Point(x, y));
+		selection->done = selection->rect.width > 4 && selection->rect.height > 4;
+	}
+
 	if (event == CV_EVENT_LBUTTONDOWN)
 	{
-		cv::Mat image(*(cv::Mat *)userdata);
+		selection->start = cv::Point(x, y);
+		selection->rect = cv::Rect();
+		selection->dragging = true;
+
+		cv::Mat image(*selection->image);
 		cv::Mat color, gray;
 		std::vector<cv::Mat> bgr, hsv;
 
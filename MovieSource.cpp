@@ -27,20 +27,22 @@ MovieSource::MovieSource(std::string filename)
 cv::Mat MovieSource::getImage()
 {
 	// Attempt to read an image from the movie file. If this fails, the movie is possibly at its end.
-	// Reset the movie position and try again.
-	movie >> image;
-	if (!movie.isOpened() || !movie.grab() || image.empty())
+	// Reset the movie position and try again. The frame keeps its own buffer, so the movie can
+	// reuse it while the image gets cropped.
+	movie >> frame;
+	if (!movie.isOpened() || !movie.grab() || frame.empty())
 	{
 		movie.set(CV_CAP_PROP_POS_FRAMES, 0);
 		movie.set(CV_CAP_PROP_POS_MSEC, 0);
-		movie >> image;
+		movie >> frame;
 	}
 
 	// If the problem persists, return the no-data image.
-	if (!movie.isOpened() || !movie.grab() || image.empty())
+	if (!movie.isOpened() || !movie.grab() || frame.empty())
 		return noData;
 
 	// If we reach here, postprocess the image as normal.
+	image = frame;
 	postProcess(image);
 	return image;
 }
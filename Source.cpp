@@ -21,15 +21,22 @@ public:
 	void normalSize();
 	void toggleFlipHorizontal();
 	void toggleFlipVertical();
+	void setRegion(cv::Rect area);
+	void clearRegion();
 	virtual cv::Mat getImage() = 0;
 protected:
+	cv::Mat frame;
 	cv::Mat image;
 	cv::Mat noData;
-	void postProcess(cv::Mat& image);
+	int reductionDenominator() const;
+	void postProcess(cv::Mat& image, int reduction = 1);
+	virtual bool cropDevice(const cv::Rect&);
 private:
 	double sizeFactor = SIZE_FACTOR_NORMAL;
 	bool flipH = false;
 	bool flipV = false;
+	cv::Rect region;
+	bool deviceCropped = false;
 };
 
 inline void Source::increaseSize()
@@ -61,9 +68,54 @@ inline void Source::toggleFlipVertical()
 	flipV = !flipV;
 }
 
-inline void Source::postProcess(cv::Mat& image)
+// The region is given in full frame coordinates. An empty region selects the full frame. If the
+// device cannot crop, the region is cut from each captured image instead.
+inline void Source::setRegion(cv::Rect area)
 {
-	cv::resize(image, image, cv::Size(), sizeFactor, sizeFactor);
+	region = area;
+	deviceCropped = cropDevice(area);
+}
+
+inline void Source::clearRegion()
+{
+	setRegion(cv::Rect());
+}
+
+// Sources that can have the device crop the image override this. An empty region restores the
+// full frame. Returns true only if the device now crops to a non-empty region.
+inline bool Source::cropDevice(const cv::Rect&)
+{
+	return false;
+}
+
+// Returns the largest power-of-two reduction (1, 2, 4 or 8) that does not shrink the image below
+// the requested size. Sources that can decode at a reduced scale use this to skip work that the
+// subsequent resize would otherwise throw away.
+inline int Source::reductionDenominator() const
+{
+	int denominator = 1;
+	while (denominator < SIZE_REDUCTION_MAX && sizeFactor * denominator * 2 <= 1.0 + 1e-6)
+		denominator *= 2;
+	return denominator;
+}
+
+// The reduction tells us by which factor the image was already shrunk during decoding, so only
+// the remainder of the size factor has to be applied here.
+inline void Source::postProcess(cv::Mat& image, int reduction)
+{
+	// Cut out the region of interest first, so the rest only deals with the pixels we need. This
+	// is a view on the captured image, not a copy.
+	if (region.area() > 0 && !deviceCropped)
+	{
+		cv::Rect r(region.x / reduction, region.y / reduction, region.width / reduction, region.height / reduction);
+		r &= cv::Rect(0, 0, image.cols, image.rows);
+		if (r.area() > 0)
+			image = image(r);
+	}
+
+	double factor = sizeFactor * reduction;
+	if (std::abs(factor - 1.0) > 1e-6)
+		cv::resize(image, image, cv::Size(), factor, factor);
 	if (flipH)
 		cv::flip(image, image, 1);
 	if (flipV)
@@ -106,11 +158,20 @@ public:
 	cv::Mat getImage() override;
 private:
 	cv::VideoCapture camera;
+	cv::Size frameSize;
+	bool canCrop = false;
+	bool mjpg = false;
+	bool raw = false;
+	void setRaw(bool enable);
+	bool cropDevice(const cv::Rect& area) override;
 };
 
 inline CameraSource::CameraSource(int cameraNumber)
 {
 	camera = cv::VideoCapture(cameraNumber);
+	mjpg = negotiateMode(camera);
+	frameSize = cv::Size((int)camera.get(CV_CAP_PROP_FRAME_WIDTH), (int)camera.get(CV_CAP_PROP_FRAME_HEIGHT));
+	canCrop = supportsCrop(camera);
 	noData = cv::imread("Test.bmp");
 	int w = std::max((int)camera.get(CV_CAP_PROP_FRAME_WIDTH), MEDIA_DEFAULT_WIDTH);
 	int h = std::max((int)camera.get(CV_CAP_PROP_FRAME_HEIGHT), MEDIA_DEFAULT_HEIGHT);
@@ -119,14 +180,53 @@ inline CameraSource::CameraSource(int cameraNumber)
 
 inline cv::Mat CameraSource::getImage()
 {
+	// When the camera delivers MJPG and the image is to be shrunk by at least half, fetch the
+	// compressed frame and let the JPEG decoder scale it down in the DCT domain.
+	int reduction = mjpg ? reductionDenominator() : 1;
+	setRaw(reduction > 1);
+
 	// Attempt to read an image from the camera. If this fails, the camera may not be available.
-	camera >> image;
-	if (!camera.isOpened() || !camera.grab() || image.empty())
+	// The frame keeps its own buffer, so the camera can reuse it while the image gets cropped.
+	camera >> frame;
+	if (!camera.isOpened() || !camera.grab() || frame.empty())
+	{
 		image = noData;
-	postProcess(image);
+		reduction = 1;
+	}
+	else if (raw && frame.rows == 1)
+	{
+		int flags = reduction == 2 ? cv::IMREAD_REDUCED_COLOR_2 :
+			reduction == 4 ? cv::IMREAD_REDUCED_COLOR_4 : cv::IMREAD_REDUCED_COLOR_8;
+		image = cv::imdecode(frame, flags);
+		if (image.empty())
+		{
+			image = noData;
+			reduction = 1;
+		}
+	}
+	else
+	{
+		// The backend ignored our request for raw data and decoded the frame itself.
+		image = frame;
+		reduction = 1;
+	}
+	postProcess(image, reduction);
 	return image;
 }
 
+inline void CameraSource::setRaw(bool enable)
+{
+	if (raw == enable)
+		return;
+	camera.set(CV_CAP_PROP_CONVERT_RGB, enable ? 0 : 1);
+	raw = enable;
+}
+
+inline bool CameraSource::cropDevice(const cv::Rect& area)
+{
+	return canCrop && ::cropDevice(camera, area, frameSize);
+}
+
 // ---------------------------------------------------------------------------------------------- *
 // Concrete subclass MovieSource to support movie files                                           *
 // ---------------------------------------------------------------------------------------------- *
@@ -154,20 +254,22 @@ inline MovieSource::MovieSource(std::string filename)
 inline cv::Mat MovieSource::getImage()
 {
 	// Attempt to read an image from the movie file. If this fails, the movie is possibly at its end.
-	// Reset the movie position and try again.
-	movie >> image;
-	if (!movie.isOpened() || !movie.grab() || image.empty())
+	// Reset the movie position and try again. The frame keeps its own buffer, so the movie can
+	// reuse it while the image gets cropped.
+	movie >> frame;
+	if (!movie.isOpened() || !movie.grab() || frame.empty())
 	{
 		movie.set(CV_CAP_PROP_POS_FRAMES, 0);
 		movie.set(CV_CAP_PROP_POS_MSEC, 0);
-		movie >> image;
+		movie >> frame;
 	}
 
 	// If the problem persists, return the no-data image.
-	if (!movie.isOpened() || !movie.grab() || image.empty())
+	if (!movie.isOpened() || !movie.grab() || frame.empty())
 		return noData;
 
 	// If we reach here, postprocess the image as normal.
+	image = frame;
 	postProcess(image);
 	return image;
 }
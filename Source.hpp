@@ -10,11 +10,13 @@
 #define SOURCE_H
 
 #include "opencv2/opencv.hpp"
+#include "Capture.hpp"
 
 #define SIZE_FACTOR_MIN			0.2
 #define SIZE_FACTOR_MAX			2.0
 #define SIZE_FACTOR_STEP		0.1
 #define SIZE_FACTOR_NORMAL		1.0
+#define SIZE_REDUCTION_MAX		8
 
 #define MEDIA_DEFAULT_WIDTH		640
 #define MEDIA_DEFAULT_HEIGHT	480
@@ -31,15 +33,22 @@ public:
 	void normalSize();
 	void toggleFlipHorizontal();
 	void toggleFlipVertical();
+	void setRegion(cv::Rect area);
+	void clearRegion();
 	virtual cv::Mat getImage() = 0;
 protected:
+	cv::Mat frame;
 	cv::Mat image;
 	cv::Mat noData;
-	void postProcess(cv::Mat& image);
+	int reductionDenominator() const;
+	void postProcess(cv::Mat& image, int reduction = 1);
+	virtual bool cropDevice(const cv::Rect&);
 private:
 	double sizeFactor = SIZE_FACTOR_NORMAL;
 	bool flipH = false;
 	bool flipV = false;
+	cv::Rect region;
+	bool deviceCropped = false;
 };
 
 // ---------------------------------------------------------------------------------------------- *
@@ -66,6 +75,12 @@ public:
 	cv::Mat getImage() override;
 private:
 	cv::VideoCapture camera;
+	cv::Size frameSize;
+	bool canCrop = false;
+	bool mjpg = false;
+	bool raw = false;
+	void setRaw(bool enable);
+	bool cropDevice(const cv::Rect& area) override;
 };
 
 // ---------------------------------------------------------------------------------------------- *
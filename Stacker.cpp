@@ -0,0 +1,247 @@
+/*
+* Joost van Stuijvenberg
+* Avans Hogeschool Breda
+*
+* CC BY-SA 4.0, see: https://creativecommons.org/licenses/by-sa/4.0/
+* sources & updates: https://github.com/joostvanstuijvenberg/DemoCV
+*/
+
+#include <algorithm>
+#include <climits>
+
+#include "Stacker.hpp"
+#include "opencv2/opencv.hpp"
+
+// ---------------------------------------------------------------------------------------------- *
+// Stacker combines the last K frames into one, for low-light and timelapse recordings            *
+// ---------------------------------------------------------------------------------------------- *
+
+Stacker::Stacker(int depth)
+{
+	this->depth = std::min(std::max(depth, STACK_DEPTH_MIN), STACK_DEPTH_MAX);
+}
+
+void Stacker::nextMode()
+{
+	switch (mode)
+	{
+	case StackMode::None:		mode = StackMode::Average;	break;
+	case StackMode::Average:	mode = StackMode::Median;	break;
+	case StackMode::Median:		mode = StackMode::Max;		break;
+	case StackMode::Max:		mode = StackMode::None;		break;
+	}
+	reset();
+}
+
+StackMode Stacker::getMode() const
+{
+	return mode;
+}
+
+int Stacker::getDepth() const
+{
+	return depth;
+}
+
+// Returns true when a whole new set of K frames has been stacked since the last time. Recording
+// only those frames turns the output into a timelapse.
+bool Stacker::isComplete() const
+{
+	return mode != StackMode::None && filled && slot == 0;
+}
+
+// Returns true when median stacking was switched off because the image is too large for the
+// per-pixel histograms. Calling reset() clears this.
+bool Stacker::isRefused() const
+{
+	return refused;
+}
+
+cv::Mat Stacker::stack(const cv::Mat& image)
+{
+	// Only 8-bit images are stacked; anything else passes through untouched.
+	if (mode == StackMode::None || image.empty() || image.depth() != CV_8U)
+		return image;
+
+	// Start over when the image size changes, e.g. after resizing the source.
+	if ((filled || slot > 0) && (image.size() != ring[0].size() || image.type() != ring[0].type()))
+		reset();
+
+	// Deep median stacks need 256 bytes per pixel channel; refuse those for large images.
+	if (mode == StackMode::Median && depth > STACK_MEDIAN_SORTED_MAX &&
+		image.total() * image.channels() * 256 > (size_t)STACK_MEDIAN_MAX_BYTES)
+	{
+		reset();
+		mode = StackMode::None;
+		refused = true;
+		return image;
+	}
+
+	// The ring holds the last K frames. Once it is full, the slot we are about to overwrite holds
+	// the frame that drops out of the window.
+	if (ring.empty())
+		ring.resize(depth);
+	switch (mode)
+	{
+	case StackMode::Average:
+		stackAverage(image);
+		break;
+	case StackMode::Median:
+		if (depth <= STACK_MEDIAN_SORTED_MAX)
+			stackMedianSorted(image);
+		else
+			stackMedianHistogram(image);
+		break;
+	case StackMode::Max:
+		stackMax(image);
+		break;
+	default:
+		break;
+	}
+	image.copyTo(ring[slot]);
+	if (++slot == depth)
+	{
+		slot = 0;
+		filled = true;
+	}
+	return result;
+}
+
+void Stacker::reset()
+{
+	slot = 0;
+	filled = false;
+	refused = false;
+	ring.clear();
+	result.release();
+	sum.release();
+	prefix.release();
+	suffix.clear();
+	sorted.clear();
+	histogram.clear();
+	median.clear();
+	below.clear();
+}
+
+// Keeps a running sum in 16 bits: add the newest frame, subtract the oldest one. OpenCV
+// vectorizes both operations, so the cost does not depend on K.
+void Stacker::stackAverage(const cv::Mat& image)
+{
+	static_assert((STACK_DEPTH_MAX + 1) * UCHAR_MAX <= USHRT_MAX, "Sum of K + 1 frames must fit in 16 bits");
+	if (sum.empty())
+		sum = cv::Mat::zeros(image.size(), CV_MAKETYPE(CV_16U, image.channels()));
+	cv::add(sum, image, sum, cv::noArray(), CV_16U);
+	if (filled)
+		cv::subtract(sum, ring[slot], sum, cv::noArray(), CV_16U);
+	int n = filled ? depth : slot + 1;
+	sum.convertTo(result, CV_8U, 1.0 / n);
+}
+
+// For shallow stacks (K up to STACK_MEDIAN_SORTED_MAX), keeps the last K values of each pixel
+// channel sorted: K bytes per pixel channel, like the ring. The value that drops out of the window
+// is replaced by the new one, which is shifted into place. That moves at most
+// STACK_MEDIAN_SORTED_MAX values, so the cost per pixel is bounded by a constant.
+void Stacker::stackMedianSorted(const cv::Mat& image)
+{
+	cv::Mat frame = image.isContinuous() ? image : image.clone();
+	size_t n = frame.total() * frame.channels();
+	if (sorted.empty())
+		sorted.assign(n * depth, 0);
+
+	const uchar* in = frame.ptr();
+	const uchar* out = filled ? ring[slot].ptr() : nullptr;
+	int middle = ((filled ? depth : slot + 1) - 1) / 2;
+	result.create(frame.size(), frame.type());
+	uchar* dst = result.ptr();
+	for (size_t e = 0; e < n; e++)
+	{
+		uchar* w = &sorted[e * depth];
+		int i;
+		if (out)
+		{
+			i = (int)(std::lower_bound(w, w + depth, out[e]) - w);
+			while (i + 1 < depth && w[i + 1] < in[e])
+			{
+				w[i] = w[i + 1];
+				i++;
+			}
+		}
+		else
+			i = slot;
+		while (i > 0 && w[i - 1] > in[e])
+		{
+			w[i] = w[i - 1];
+			i--;
+		}
+		w[i] = in[e];
+		dst[e] = w[middle];
+	}
+}
+
+// For deeper stacks, keeps a 256-bin histogram per pixel channel (counts fit in a byte, as K is
+// at most 255) together with the current median and the number of values below it. Each new
+// frame moves the median only as far as the values changed, whatever K is. This takes 256 bytes
+// per pixel channel, which is why stack() refuses images above STACK_MEDIAN_MAX_BYTES.
+void Stacker::stackMedianHistogram(const cv::Mat& image)
+{
+	cv::Mat frame = image.isContinuous() ? image : image.clone();
+	size_t n = frame.total() * frame.channels();
+	if (histogram.empty())
+	{
+		histogram.assign(n * 256, 0);
+		median.assign(n, 0);
+		below.assign(n, 0);
+	}
+
+	const uchar* in = frame.ptr();
+	const uchar* out = filled ? ring[slot].ptr() : nullptr;
+	int rank = ((filled ? depth : slot + 1) - 1) / 2;
+	result.create(frame.size(), frame.type());
+	uchar* dst = result.ptr();
+	for (size_t e = 0; e < n; e++)
+	{
+		uchar* h = &histogram[e * 256];
+		int m = median[e], lt = below[e];
+		h[in[e]]++;
+		if (in[e] < m)
+			lt++;
+		if (out)
+		{
+			h[out[e]]--;
+			if (out[e] < m)
+				lt--;
+		}
+		while (lt > rank)
+			lt -= h[--m];
+		while (lt + h[m] <= rank)
+			lt += h[m++];
+		median[e] = (uchar)m;
+		below[e] = (uchar)lt;
+		dst[e] = (uchar)m;
+	}
+}
+
+// Sliding maximum after van Herk / Gil-Werman: the frames are grouped in blocks of K. We keep a
+// running maximum of the current block and, once per block, compute the suffix maxima of the
+// previous one. Any window of K frames is then the maximum of one suffix and the running prefix.
+void Stacker::stackMax(const cv::Mat& image)
+{
+	if (slot == 0)
+	{
+		if (filled)
+		{
+			suffix.resize(depth);
+			ring[depth - 1].copyTo(suffix[depth - 1]);
+			for (int i = depth - 2; i >= 0; i--)
+				cv::max(ring[i], suffix[i + 1], suffix[i]);
+		}
+		image.copyTo(prefix);
+	}
+	else
+		cv::max(prefix, image, prefix);
+
+	if (filled && slot + 1 < depth)
+		cv::max(suffix[slot + 1], prefix, result);
+	else
+		prefix.copyTo(result);
+}
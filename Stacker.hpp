@@ -0,0 +1,61 @@
+/*
+* Joost van Stuijvenberg
+* Avans Hogeschool Breda
+*
+* CC BY-SA 4.0, see: https://creativecommons.org/licenses/by-sa/4.0/
+* sources & updates: https://github.com/joostvanstuijvenberg/DemoCV
+*/
+
+#ifndef STACKER_H
+#define STACKER_H
+
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+
+#define STACK_DEPTH_DEFAULT		8
+#define STACK_DEPTH_MIN			1
+#define STACK_DEPTH_MAX			255
+
+#define STACK_MEDIAN_SORTED_MAX	16
+#define STACK_MEDIAN_MAX_BYTES	(128 << 20)
+
+enum class StackMode { None, Average, Median, Max };
+
+// ---------------------------------------------------------------------------------------------- *
+// Stacker combines the last K frames into one, for low-light and timelapse recordings            *
+// ---------------------------------------------------------------------------------------------- *
+
+class Stacker
+{
+public:
+	Stacker(int depth = STACK_DEPTH_DEFAULT);
+	void nextMode();
+	StackMode getMode() const;
+	int getDepth() const;
+	bool isComplete() const;
+	bool isRefused() const;
+	cv::Mat stack(const cv::Mat& image);
+	void reset();
+private:
+	StackMode mode = StackMode::None;
+	int depth;
+	int slot = 0;
+	bool filled = false;
+	bool refused = false;
+	std::vector<cv::Mat> ring;
+	cv::Mat result;
+	cv::Mat sum;
+	cv::Mat prefix;
+	std::vector<cv::Mat> suffix;
+	std::vector<uchar> sorted;
+	std::vector<uchar> histogram;
+	std::vector<uchar> median;
+	std::vector<uchar> below;
+	void stackAverage(const cv::Mat& image);
+	void stackMedianSorted(const cv::Mat& image);
+	void stackMedianHistogram(const cv::Mat& image);
+	void stackMax(const cv::Mat& image);
+};
+
+#endif